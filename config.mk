@@ -2,6 +2,8 @@ TARGET = fetcho
 VERSION = 1.0.0
 
 LDLIBS += -lprocps
+LDLIBS += -lpthread
 EXTRA_SRC_FILES =
 EXTRA_BINARY_FILES =
+EXTRA_LOGO_FILES =
 CFLAGS += -Wall
@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#include "cgroup.h"
+
+static const char *cgroup_file_names[cgroup_file_count] = {
+        [cgroup_memory_current] = "memory.current",
+        [cgroup_memory_max] = "memory.max",
+        [cgroup_memory_stat] = "memory.stat",
+        [cgroup_swap_current] = "memory.swap.current",
+        [cgroup_swap_max] = "memory.swap.max",
+        [cgroup_cpu_max] = "cpu.max",
+};
+
+static int open_cgroup_dir(void) {
+	// FO_CGROUP points straight at a cgroup directory, e.g. a fake tree for testing
+	char *dir = getenv("FO_CGROUP");
+	if (dir) return open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	// the unified hierarchy is the "0::" line in /proc/self/cgroup
+	FILE *fp = fopen("/proc/self/cgroup", "r");
+	if (!fp) return -1;
+
+	char *buf = NULL, *path = NULL;
+	size_t buf_size = 0;
+	ssize_t len;
+	while ((len = getline(&buf, &buf_size, fp)) >= 0) {
+		if (strncmp(buf, "0::", 3) != 0) continue;
+		if (len > 0 && buf[len - 1] == '\n') buf[len - 1] = '\0';
+		path = buf + 3;
+		break;
+	}
+	fclose(fp);
+
+	// the unified hierarchy is mounted at /sys/fs/cgroup, or /sys/fs/cgroup/unified on hybrid systems
+	int fd = -1;
+	const char *mounts[] = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"};
+	for (size_t i = 0; path && fd < 0 && i < sizeof(mounts) / sizeof(mounts[0]); ++i) {
+		char *full_path;
+		if (asprintf(&full_path, "%s%s/cgroup.controllers", mounts[i], path) < 0) {
+			warnx("asprintf");
+			break;
+		}
+		// only accept a directory that is actually part of a cgroup v2 hierarchy
+		if (access(full_path, F_OK) == 0) {
+			*strrchr(full_path, '/') = '\0';
+			fd = open(full_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		}
+		free(full_path);
+	}
+	free(buf);
+	return fd;
+}
+
+static int get_cgroup_fd(enum cgroup_file file) {
+	static int dir_fd = -1;
+	static bool dir_init = false;
+	if (!dir_init) {
+		dir_init = true;
+		dir_fd = open_cgroup_dir();
+	}
+	if (dir_fd < 0) return -1;
+
+	static int fds[cgroup_file_count];
+	static bool init[cgroup_file_count];
+	if (!init[file]) {
+		init[file] = true;
+		fds[file] = openat(dir_fd, cgroup_file_names[file], O_RDONLY | O_CLOEXEC);
+	}
+	return fds[file];
+}
+
+static ssize_t read_cgroup_file(enum cgroup_file file, char *buf, size_t size) {
+	// cgroupfs regenerates the contents on every read from offset 0, so the descriptor can be reused
+	int fd = get_cgroup_fd(file);
+	if (fd < 0) return -1;
+	ssize_t len = pread(fd, buf, size - 1, 0);
+	if (len < 0) return -1;
+	buf[len] = '\0';
+	return len;
+}
+
+bool cgroup_read_value(enum cgroup_file file, uint64_t *value) {
+	char buf[64];
+	if (read_cgroup_file(file, buf, sizeof(buf)) <= 0) return false;
+	if (strncmp(buf, "max", 3) == 0) return false;
+
+	char *end;
+	*value = strtoull(buf, &end, 10);
+	return end != buf;
+}
+
+static bool read_stat_value(enum cgroup_file file, const char *key, uint64_t *value) {
+	// memory.stat is "key value" lines, a few kilobytes in size
+	char buf[0x2000];
+	if (read_cgroup_file(file, buf, sizeof(buf)) <= 0) return false;
+
+	size_t key_len = strlen(key);
+	for (char *line = buf; line && *line;) {
+		if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ') {
+			*value = strtoull(line + key_len + 1, NULL, 10);
+			return true;
+		}
+		char *eol = strchr(line, '\n');
+		line = eol ? eol + 1 : NULL;
+	}
+	return false;
+}
+
+bool cgroup_memory(uint64_t *used, uint64_t *total) {
+	uint64_t current, max;
+	if (!cgroup_read_value(cgroup_memory_max, &max)) return false;
+	if (!cgroup_read_value(cgroup_memory_current, &current)) return false;
+
+	// leave out page cache that can be dropped, like free(1) does for the host
+	uint64_t inactive_file;
+	if (read_stat_value(cgroup_memory_stat, "inactive_file", &inactive_file) && inactive_file < current)
+		current -= inactive_file;
+
+	*used = current;
+	*total = max;
+	return true;
+}
+
+bool cgroup_swap(uint64_t *used, uint64_t *total) {
+	uint64_t current, max;
+	if (!cgroup_read_value(cgroup_swap_current, &current)) return false;
+	if (!cgroup_read_value(cgroup_swap_max, &max)) {
+		// swap is rarely limited on its own, but a memory limited cgroup should still show its own usage
+		uint64_t memory_max;
+		if (!cgroup_read_value(cgroup_memory_max, &memory_max)) return false;
+		max = UINT64_MAX; // the caller caps this at the host's total
+	}
+	*used = current;
+	*total = max;
+	return true;
+}
+
+bool cgroup_cpu_quota(uint64_t *quota, uint64_t *period) {
+	// "$MAX $PERIOD", where $MAX is "max" when there is no quota
+	char buf[64];
+	if (read_cgroup_file(cgroup_cpu_max, buf, sizeof(buf)) <= 0) return false;
+	if (strncmp(buf, "max", 3) == 0) return false;
+
+	char *end;
+	*quota = strtoull(buf, &end, 10);
+	if (end == buf) return false;
+	*period = strtoull(end, NULL, 10);
+	return *period > 0;
+}
+
+bool cgroup_limited(void) {
+	uint64_t a, b;
+	return cgroup_read_value(cgroup_memory_max, &a) || cgroup_cpu_quota(&a, &b);
+}
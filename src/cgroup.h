@@ -0,0 +1,28 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// files in our cgroup v2 directory, their descriptors are opened once and reread with pread
+enum cgroup_file { cgroup_memory_current,
+	               cgroup_memory_max,
+	               cgroup_memory_stat,
+	               cgroup_swap_current,
+	               cgroup_swap_max,
+	               cgroup_cpu_max,
+	               cgroup_file_count };
+
+// reads a single number, returns false if the file is missing or contains "max"
+bool cgroup_read_value(enum cgroup_file file, uint64_t *value);
+
+// memory usage excluding reclaimable page cache, and the memory limit
+bool cgroup_memory(uint64_t *used, uint64_t *total);
+// swap usage when there is a swap or memory limit, total is UINT64_MAX without a swap limit
+bool cgroup_swap(uint64_t *used, uint64_t *total);
+
+// cpu.max quota in microseconds per period, false if there is no quota
+bool cgroup_cpu_quota(uint64_t *quota, uint64_t *period);
+
+// true if the cgroup puts a memory or cpu limit on us, i.e. we are most likely in a container
+bool cgroup_limited(void);
+#endif //CGROUP_H
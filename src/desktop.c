@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "desktop.h"
+
+// most processes to look at when scanning /proc, so hosts with huge process counts stay fast
+#define DESKTOP_SCAN_LIMIT 4096
+
+struct desktop_pattern {
+	const char *pattern; // matched case insensitively anywhere in the environment
+	const char *name;
+	const char *env;       // variable that is only set in this desktop, or NULL
+	const char *processes; // space separated names of the window manager or shell binary, or NULL
+};
+
+// earlier entries win when more than one matches
+static const struct desktop_pattern desktop_patterns[] = {
+        {"kde", "KDE Plasma", NULL, NULL},
+        {"plasma", "KDE Plasma", NULL, "plasmashell"},
+        {"kwin", "KDE Plasma", NULL, "kwin_x11 kwin_wayland"},
+        {"cinnamon", "Cinnamon", NULL, "cinnamon"},
+        {"lxqt", "LXQt", NULL, NULL},
+        {"lxde", "LXDE", NULL, NULL},
+        {"deepin", "Deepin", NULL, "deepin-wm"},
+        {"enlightenment", "Enlightenment", NULL, "enlightenment"},
+        {"budgie", "Budgie", NULL, "budgie-wm"},
+        {"pantheon", "Pantheon", NULL, "gala"},
+        {"trinity", "Trinity", "TDE_FULL_SESSION", "twin"},
+        {"mate", "MATE", "MATE_DESKTOP_SESSION_ID", "marco"},
+        {"xfce", "Xfce", NULL, NULL},
+        {"gnome", "GNOME", "GNOME_DESKTOP_SESSION_ID", "gnome-shell"},
+        {"unity", "GNOME", NULL, NULL},
+        {"xfwm", "Xfwm", NULL, "xfwm4"},
+        {"openbox", "Openbox", NULL, "openbox"},
+        {"i3", "i3", NULL, "i3"},
+        {"bspwm", "bspwm", NULL, "bspwm"},
+        {"mutter", "Mutter", NULL, "mutter"},
+        {"sawfish", "Sawfish", NULL, "sawfish"},
+        {"fluxbox", "Fluxbox", NULL, "fluxbox"},
+        {"icewm", "IceWM", NULL, "icewm"},
+        {"awesome", "awesome", NULL, "awesome"},
+        {"dwm", "dwm", NULL, "dwm"},
+};
+
+#define PATTERN_COUNT (sizeof(desktop_patterns) / sizeof(desktop_patterns[0]))
+#define NO_MATCH PATTERN_COUNT
+
+// bit i is set for each byte that pattern i starts with, in either case
+static uint32_t first_byte_patterns[256];
+
+// process names split out of the table, with the same bitmask for their first byte
+#define MAX_PROCESS_NAMES 64
+static struct {
+	char name[16]; // the kernel cuts comm down to 15 bytes
+	size_t pattern;
+} process_names[MAX_PROCESS_NAMES];
+static size_t process_name_count = 0;
+static uint64_t first_byte_processes[256];
+
+static void compile_patterns(void) {
+	static bool compiled = false;
+	if (compiled) return;
+	compiled = true;
+
+	_Static_assert(PATTERN_COUNT <= 32, "pattern set must fit in a uint32_t");
+	for (size_t i = 0; i < PATTERN_COUNT; ++i) {
+		unsigned char c = desktop_patterns[i].pattern[0];
+		first_byte_patterns[(unsigned char) tolower(c)] |= 1u << i;
+		first_byte_patterns[(unsigned char) toupper(c)] |= 1u << i;
+
+		const char *p = desktop_patterns[i].processes;
+		while (p && *p && process_name_count < MAX_PROCESS_NAMES) {
+			size_t len = strcspn(p, " ");
+			snprintf(process_names[process_name_count].name, sizeof(process_names[0].name), "%.*s", (int) len, p);
+			process_names[process_name_count].pattern = i;
+			first_byte_processes[(unsigned char) *p] |= 1ull << process_name_count;
+			++process_name_count;
+			p += len;
+			p += strspn(p, " ");
+		}
+	}
+}
+
+// the patterns starting at str that have a higher priority than best, as a bitmask
+static inline uint32_t candidates(const char *str, size_t best) {
+	uint32_t mask = first_byte_patterns[(unsigned char) *str];
+	if (best < 32) mask &= (1u << best) - 1;
+	return mask;
+}
+
+static size_t match_at(const char *str, uint32_t mask) {
+	// returns the highest priority pattern in mask that matches at str
+	for (; mask; mask &= mask - 1) {
+		size_t i = __builtin_ctz(mask);
+		const char *pattern = desktop_patterns[i].pattern;
+		if (strncasecmp(str, pattern, strlen(pattern)) == 0) return i;
+	}
+	return NO_MATCH;
+}
+
+static size_t match_anywhere(const char *str, size_t best) {
+	// single pass over str, only trying patterns that start with the current byte
+	for (; *str && best > 0; ++str) {
+		uint32_t mask = candidates(str, best);
+		if (!mask) continue;
+		size_t i = match_at(str, mask);
+		if (i < best) best = i;
+	}
+	return best;
+}
+
+static size_t match_environment(void) {
+	size_t best = NO_MATCH;
+	for (size_t i = 0; i < PATTERN_COUNT; ++i) {
+		if (desktop_patterns[i].env && getenv(desktop_patterns[i].env)) {
+			best = i;
+			break;
+		}
+	}
+
+	char *de = getenv("XDG_CURRENT_DESKTOP");
+	if (de) best = match_anywhere(de, best);
+	return best;
+}
+
+struct linux_dirent64 {
+	ino64_t d_ino;
+	off64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+static size_t match_processes(void) {
+	// look for a known desktop or window manager process owned by us
+	int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (proc_fd < 0) return NO_MATCH;
+
+	uid_t uid = getuid();
+	size_t scanned = 0;
+	size_t found = NO_MATCH;
+
+	char buf[0x4000];
+	long len;
+	while (found == NO_MATCH && scanned < DESKTOP_SCAN_LIMIT && (len = syscall(SYS_getdents64, proc_fd, buf, sizeof(buf))) > 0) {
+		for (long pos = 0; pos < len && found == NO_MATCH && scanned < DESKTOP_SCAN_LIMIT;) {
+			struct linux_dirent64 *entry = (struct linux_dirent64 *) (buf + pos);
+			pos += entry->d_reclen;
+
+			if (entry->d_name[0] < '1' || entry->d_name[0] > '9') continue; // not a pid
+			++scanned;
+
+			// only our own processes, otherwise root would pick up e.g. a display manager's greeter
+			struct stat st;
+			if (fstatat(proc_fd, entry->d_name, &st, 0) < 0 || st.st_uid != uid) continue;
+
+			char path[64];
+			snprintf(path, sizeof(path), "%s/comm", entry->d_name);
+			int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) continue;
+			char comm[32];
+			ssize_t comm_len = read(fd, comm, sizeof(comm) - 1);
+			close(fd);
+			if (comm_len <= 0) continue;
+			if (comm[comm_len - 1] == '\n') --comm_len;
+			comm[comm_len] = '\0';
+
+			// whole names only, helpers like gnome-keyring-daemon run outside their desktop too
+			for (uint64_t mask = first_byte_processes[(unsigned char) comm[0]]; mask && found == NO_MATCH; mask &= mask - 1) {
+				size_t i = __builtin_ctzll(mask);
+				if (strcmp(comm, process_names[i].name) == 0) found = process_names[i].pattern;
+			}
+		}
+	}
+
+	close(proc_fd);
+	return found;
+}
+
+const char *detect_desktop(void) {
+	compile_patterns();
+
+	size_t match = match_environment();
+	if (match != NO_MATCH) return desktop_patterns[match].name;
+
+	// show the environment as is if nothing recognised it
+	char *de = getenv("XDG_CURRENT_DESKTOP");
+	if (de) return de;
+
+	char *session = getenv("DESKTOP_SESSION");
+	if (session) {
+		match = match_anywhere(session, NO_MATCH);
+		return match != NO_MATCH ? desktop_patterns[match].name : session;
+	}
+
+	// nothing in the environment at all, e.g. a window manager started from startx
+	match = match_processes();
+	return match != NO_MATCH ? desktop_patterns[match].name : NULL;
+}
@@ -0,0 +1,6 @@
+#ifndef DESKTOP_H
+#define DESKTOP_H
+
+// name of the running desktop environment or window manager, or NULL if none was found
+const char *detect_desktop(void);
+#endif //DESKTOP_H
@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <err.h>
+#include <sys/statfs.h>
+
+#include "disk.h"
+
+#define DISK_MAX_WORKERS 16
+#define DISK_DEFAULT_TIMEOUT 500 // milliseconds to wait for statfs, a hung network mount never returns
+
+static const char *default_fs_types = "ext2 ext3 ext4 xfs btrfs zfs bcachefs f2fs jfs reiserfs vfat exfat ntfs ntfs3 fuseblk nfs nfs4 cifs smb3";
+
+static bool fs_type_selected(const char *types, const char *type, size_t type_len) {
+	// types is a space separated list
+	for (const char *p = types; *p;) {
+		size_t len = strcspn(p, " ");
+		if (len == type_len && memcmp(p, type, len) == 0) return true;
+		p += len;
+		p += strspn(p, " ");
+	}
+	return false;
+}
+
+static void unescape_octal(char *str) {
+	// mountinfo escapes space, tab, newline and backslash as \ooo
+	char *out = str;
+	for (char *in = str; *in; ++in) {
+		if (in[0] == '\\' && in[1] >= '0' && in[1] <= '3' && in[2] >= '0' && in[2] <= '7' && in[3] >= '0' && in[3] <= '7') {
+			*out++ = (in[1] - '0') << 6 | (in[2] - '0') << 3 | (in[3] - '0');
+			in += 3;
+		} else
+			*out++ = *in;
+	}
+	*out = '\0';
+}
+
+struct mount_list {
+	char **mount_points;
+	char **devices; // major:minor, so bind mounts of the same filesystem are only listed once
+	size_t count;
+	size_t capacity;
+};
+
+static void parse_mountinfo_line(char *line, const char *types, struct mount_list *list) {
+	// "36 35 98:0 /root /mount/point options [optional fields...] - fstype source super_options"
+	char *fields[5];
+	char *saveptr;
+	char *tok = strtok_r(line, " ", &saveptr);
+	for (size_t i = 0; i < 5; ++i, tok = strtok_r(NULL, " ", &saveptr)) {
+		if (!tok) return;
+		fields[i] = tok;
+	}
+	for (; tok && strcmp(tok, "-") != 0; tok = strtok_r(NULL, " ", &saveptr));
+	if (!tok || !(tok = strtok_r(NULL, " ", &saveptr))) return;
+
+	// a later mount on the same mount point hides the earlier one, and statfs would only see the later one,
+	// so drop the hidden one whether or not the new mount is shown
+	unescape_octal(fields[4]);
+	for (size_t i = 0; i < list->count; ++i) {
+		if (strcmp(list->mount_points[i], fields[4]) != 0) continue;
+		free(list->mount_points[i]);
+		free(list->devices[i]);
+		--list->count;
+		memmove(&list->mount_points[i], &list->mount_points[i + 1], (list->count - i) * sizeof(char *));
+		memmove(&list->devices[i], &list->devices[i + 1], (list->count - i) * sizeof(char *));
+		break;
+	}
+
+	// filter before allocating anything
+	if (!fs_type_selected(types, tok, strlen(tok))) return;
+	for (size_t i = 0; i < list->count; ++i)
+		if (strcmp(list->devices[i], fields[2]) == 0) return;
+
+	if (list->count >= list->capacity) {
+		size_t capacity = list->capacity ? list->capacity * 2 : 16;
+		char **mount_points = realloc(list->mount_points, capacity * sizeof(char *));
+		if (!mount_points) return;
+		list->mount_points = mount_points;
+		char **devices = realloc(list->devices, capacity * sizeof(char *));
+		if (!devices) return;
+		list->devices = devices;
+		list->capacity = capacity;
+	}
+
+	char *mount_point = strdup(fields[4]);
+	char *device = strdup(fields[2]);
+	if (!mount_point || !device) {
+		warn("strdup");
+		free(mount_point);
+		free(device);
+		return;
+	}
+	list->mount_points[list->count] = mount_point;
+	list->devices[list->count] = device;
+	++list->count;
+}
+
+static void read_mounts(struct mount_list *list) {
+	char *types = getenv("FO_DISK_FS");
+	if (!types) types = (char *) default_fs_types;
+
+	int fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return;
+
+	// parse line by line as it is read, only a partial line is carried over between reads
+	char buf[0x4000];
+	size_t len = 0;
+	bool skipping = false; // inside a line too long for the buffer, drop it up to the next newline
+	for (;;) {
+		ssize_t result = read(fd, buf + len, sizeof(buf) - len - 1);
+		if (result < 0 && errno == EINTR) continue;
+		if (result <= 0) break;
+		len += result;
+		buf[len] = '\0';
+
+		char *line = buf, *eol;
+		while ((eol = memchr(line, '\n', buf + len - line))) {
+			*eol = '\0';
+			if (!skipping) parse_mountinfo_line(line, types, list);
+			skipping = false;
+			line = eol + 1;
+		}
+
+		len = buf + len - line;
+		if (len == sizeof(buf) - 1) {
+			skipping = true;
+			len = 0;
+		}
+		memmove(buf, line, len);
+	}
+	close(fd);
+}
+
+// shared between the caller and the workers, freed by whoever leaves last since a worker can be stuck in statfs forever
+struct disk_job {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t refs;
+	size_t count;
+	size_t next; // next mount to hand out
+	size_t done;
+	char **mount_points;
+	struct disk_usage *results;
+};
+
+static void release_job(struct disk_job *job) {
+	// called with the lock held
+	if (--job->refs > 0) {
+		pthread_mutex_unlock(&job->lock);
+		return;
+	}
+	pthread_mutex_unlock(&job->lock);
+	for (size_t i = 0; i < job->count; ++i) free(job->mount_points[i]);
+	free(job->mount_points);
+	free(job->results);
+	pthread_cond_destroy(&job->cond);
+	pthread_mutex_destroy(&job->lock);
+	free(job);
+}
+
+static void *disk_worker(void *arg) {
+	struct disk_job *job = arg;
+	pthread_mutex_lock(&job->lock);
+	while (job->next < job->count) {
+		size_t i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		struct statfs st;
+		bool ok = statfs(job->mount_points[i], &st) == 0;
+
+		pthread_mutex_lock(&job->lock);
+		if (ok && st.f_blocks > 0) {
+			job->results[i].available = true;
+			job->results[i].total = (uint64_t) st.f_blocks * st.f_frsize;
+			job->results[i].used = (uint64_t) (st.f_blocks - st.f_bfree) * st.f_frsize;
+		}
+		++job->done;
+		pthread_cond_signal(&job->cond);
+	}
+	release_job(job);
+	return NULL;
+}
+
+static long get_timeout(void) {
+	char *timeout = getenv("FO_DISK_TIMEOUT");
+	if (timeout) {
+		char *end;
+		long value = strtol(timeout, &end, 10);
+		if (end != timeout && *end == '\0' && value >= 0) return value;
+	}
+	return DISK_DEFAULT_TIMEOUT;
+}
+
+size_t get_disk_usage(struct disk_usage **disks) {
+	*disks = NULL;
+
+	struct mount_list list = {0};
+	read_mounts(&list);
+	for (size_t i = 0; i < list.count; ++i) free(list.devices[i]);
+	free(list.devices);
+	if (list.count == 0) {
+		free(list.mount_points);
+		return 0;
+	}
+
+	struct disk_usage *out = calloc(list.count, sizeof(struct disk_usage));
+	struct disk_job *job = calloc(1, sizeof(struct disk_job));
+	struct disk_usage *results = calloc(list.count, sizeof(struct disk_usage));
+	if (!out || !job || !results) {
+		warn("calloc");
+		for (size_t i = 0; i < list.count; ++i) free(list.mount_points[i]);
+		free(list.mount_points);
+		free(out);
+		free(job);
+		free(results);
+		return 0;
+	}
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&job->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&job->lock, NULL);
+	job->refs = 1;
+	job->count = list.count;
+	job->mount_points = list.mount_points;
+	job->results = results;
+
+	// statfs the mounts in parallel, so one hung mount only holds up its own worker
+	pthread_mutex_lock(&job->lock);
+	size_t workers = list.count < DISK_MAX_WORKERS ? list.count : DISK_MAX_WORKERS;
+	for (size_t i = 0; i < workers; ++i) {
+		pthread_t thread;
+		++job->refs;
+		if (pthread_create(&thread, NULL, disk_worker, job) != 0) {
+			--job->refs;
+			break;
+		}
+		pthread_detach(thread);
+	}
+
+	if (job->refs == 1) {
+		// no threads could be started, do the work here without a deadline
+		pthread_mutex_unlock(&job->lock);
+		++job->refs;
+		disk_worker(job);
+		pthread_mutex_lock(&job->lock);
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	long timeout = get_timeout();
+	deadline.tv_sec += timeout / 1000;
+	deadline.tv_nsec += (timeout % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		++deadline.tv_sec;
+		deadline.tv_nsec -= 1000000000;
+	}
+	while (job->done < job->count)
+		if (pthread_cond_timedwait(&job->cond, &job->lock, &deadline) == ETIMEDOUT) break;
+
+	// anything not finished by now is reported as unavailable
+	size_t count = 0;
+	for (size_t i = 0; i < job->count; ++i) {
+		char *mount_point = strdup(job->mount_points[i]);
+		if (!mount_point) continue;
+		out[count] = job->results[i];
+		out[count++].mount_point = mount_point;
+	}
+	job->next = job->count; // stop handing out work
+	release_job(job);
+
+	*disks = out;
+	return count;
+}
+
+void free_disk_usage(struct disk_usage *disks, size_t count) {
+	if (!disks) return;
+	for (size_t i = 0; i < count; ++i) free(disks[i].mount_point);
+	free(disks);
+}
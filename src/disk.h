@@ -0,0 +1,18 @@
+#ifndef DISK_H
+#define DISK_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct disk_usage {
+	char *mount_point;
+	bool available; // false if statfs failed or did not finish before the deadline
+	uint64_t used;
+	uint64_t total;
+};
+
+// usage of the mounted filesystems of the types in FO_DISK_FS, or a default list of on-disk and network filesystems
+// returns the number of entries in *disks, which the caller frees with free_disk_usage
+size_t get_disk_usage(struct disk_usage **disks);
+void free_disk_usage(struct disk_usage *disks, size_t count);
+#endif //DISK_H
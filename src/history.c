@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "history.h"
+#include "modules.h"
+
+// the history file is a header followed by a ring of fixed size records
+// each record stores its values as 32 bit deltas from the base values in the header, which are the first values recorded,
+// so a record can be found and decoded without reading any other record, and reading the file never parses text
+
+#define HISTORY_MAGIC "fetchoH1"
+#define HISTORY_CAPACITY 8192 // records, enough for a year of a few logins a day
+
+struct history_header {
+	char magic[8];
+	uint32_t record_size;
+	uint32_t capacity;
+	uint64_t count;    // records ever appended, the next one goes in slot count % capacity
+	int64_t base_time; // unix time of the first record
+	uint64_t base[history_field_count];
+};
+
+// units of the deltas, bytes are stored in KiB so the range of an int32 is big enough
+static const int64_t history_field_scale[history_field_count] = {
+        [history_uptime] = 1,
+        [history_ram_used] = 1024,
+        [history_ram_total] = 1024,
+        [history_swap_used] = 1024,
+        [history_swap_total] = 1024,
+};
+
+struct history_record {
+	uint32_t time; // seconds after base_time
+	int32_t delta[history_field_count];
+};
+
+static char *history_path(void) {
+	char *path = getenv("FO_HISTORY");
+	if (path) return strdup(path);
+
+	char *state = getenv("XDG_STATE_HOME");
+	if (state && *state) {
+		if (asprintf(&path, "%s/fetcho/history", state) < 0) return NULL;
+	} else {
+		char *home = getenv("HOME");
+		if (!home) return NULL;
+		if (asprintf(&path, "%s/.local/state/fetcho/history", home) < 0) return NULL;
+	}
+	return path;
+}
+
+static bool make_parent_dirs(char *path) {
+	// mkdir -p of everything before the last slash
+	for (char *slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		int result = mkdir(path, 0700);
+		*slash = '/';
+		if (result < 0 && errno != EEXIST) {
+			warn("mkdir");
+			return false;
+		}
+	}
+	return true;
+}
+
+static int32_t clamp_delta(int64_t delta) {
+	if (delta > INT32_MAX) return INT32_MAX;
+	if (delta < INT32_MIN) return INT32_MIN;
+	return delta;
+}
+
+static bool valid_header(const struct history_header *header, off_t size) {
+	return memcmp(header->magic, HISTORY_MAGIC, sizeof(header->magic)) == 0 &&
+	       header->record_size == sizeof(struct history_record) &&
+	       header->capacity > 0 &&
+	       size >= sizeof(struct history_header) + (off_t) header->capacity * sizeof(struct history_record);
+}
+
+bool history_record(void) {
+	uint64_t values[history_field_count] = {0};
+	unsigned long uptime;
+	size_t used, total;
+	if (get_uptime(&uptime)) values[history_uptime] = uptime;
+	if (get_ram(&used, &total)) {
+		values[history_ram_used] = used;
+		values[history_ram_total] = total;
+	}
+	if (get_swap(&used, &total)) {
+		values[history_swap_used] = used;
+		values[history_swap_total] = total;
+	}
+	time_t now = time(NULL);
+
+	char *path = history_path();
+	if (!path) {
+		warnx("no history file, set XDG_STATE_HOME or HOME");
+		return false;
+	}
+	if (!make_parent_dirs(path)) {
+		free(path);
+		return false;
+	}
+
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		warn("%s", path);
+		free(path);
+		return false;
+	}
+	flock(fd, LOCK_EX); // another login could be recording at the same time
+
+	bool ok = false;
+	struct history_header *header = MAP_FAILED;
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		warn("%s", path);
+		goto end;
+	}
+
+	if (st.st_size == 0) {
+		// new file, this run's values become the base everything else is relative to
+		struct history_header new_header = {.magic = HISTORY_MAGIC, .record_size = sizeof(struct history_record), .capacity = HISTORY_CAPACITY, .count = 0, .base_time = now};
+		memcpy(new_header.base, values, sizeof(values));
+		st.st_size = sizeof(struct history_header) + (off_t) HISTORY_CAPACITY * sizeof(struct history_record);
+		if (pwrite(fd, &new_header, sizeof(new_header), 0) != sizeof(new_header) || ftruncate(fd, st.st_size) < 0) {
+			warn("%s", path);
+			goto end;
+		}
+	}
+
+	header = mmap(NULL, sizeof(struct history_header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (header == MAP_FAILED) {
+		warn("mmap");
+		goto end;
+	}
+	if (!valid_header(header, st.st_size)) {
+		warnx("%s: not a history file, or from a different version", path);
+		goto end;
+	}
+
+	struct history_record record = {.time = now > header->base_time ? now - header->base_time : 0};
+	for (size_t i = 0; i < history_field_count; ++i)
+		record.delta[i] = clamp_delta(((int64_t) values[i] - (int64_t) header->base[i]) / history_field_scale[i]);
+
+	// the record goes out in one pwrite, and the count is bumped through the mapping once it is written
+	off_t offset = sizeof(struct history_header) + (off_t) (header->count % header->capacity) * sizeof(struct history_record);
+	if (pwrite(fd, &record, sizeof(record), offset) != sizeof(record)) {
+		warn("%s", path);
+		goto end;
+	}
+	++header->count;
+	ok = true;
+
+end:
+	if (header != MAP_FAILED) munmap(header, sizeof(struct history_header));
+	close(fd);
+	free(path);
+	return ok;
+}
+
+static const struct history_header *history_map = NULL;
+static uint64_t history_count; // count at load time, the mapping is shared so later appends show up in it
+
+bool history_load(void) {
+	char *path = history_path();
+	if (!path) return false;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		if (errno != ENOENT) warn("%s", path);
+		free(path);
+		return false;
+	}
+
+	struct stat st;
+	void *map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= sizeof(struct history_header))
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		free(path);
+		return false;
+	}
+	if (!valid_header(map, st.st_size)) {
+		warnx("%s: not a history file, or from a different version", path);
+		munmap(map, st.st_size);
+		free(path);
+		return false;
+	}
+
+	free(path);
+	history_map = map;
+	history_count = history_map->count;
+	return true;
+}
+
+bool history_get_stats(enum history_field field, struct history_stats *stats) {
+	if (!history_map || history_count == 0) return false;
+
+	const struct history_record *records = (const struct history_record *) (history_map + 1);
+	uint64_t capacity = history_map->capacity;
+	uint64_t count = history_count < capacity ? history_count : capacity;
+	uint64_t first = history_count - count; // oldest record still in the ring
+	int64_t base = history_map->base[field];
+
+	int64_t min = INT64_MAX, max = INT64_MIN, sum = 0;
+	int64_t buckets[HISTORY_SPARKLINE_WIDTH] = {0};
+	uint64_t bucket_counts[HISTORY_SPARKLINE_WIDTH] = {0};
+	size_t bucket_total = count < HISTORY_SPARKLINE_WIDTH ? count : HISTORY_SPARKLINE_WIDTH;
+
+	for (uint64_t i = 0; i < count; ++i) {
+		int64_t value = base + (int64_t) records[(first + i) % capacity].delta[field] * history_field_scale[field];
+		if (value < min) min = value;
+		if (value > max) max = value;
+		sum += value;
+
+		// spread the records evenly over the sparkline, oldest on the left
+		size_t bucket = i * bucket_total / count;
+		buckets[bucket] += value;
+		++bucket_counts[bucket];
+	}
+
+	stats->min = min;
+	stats->max = max;
+	stats->avg = sum / (int64_t) count;
+
+	static const char *blocks[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+	char *spark = stats->sparkline;
+	for (size_t i = 0; i < bucket_total; ++i) {
+		int64_t value = buckets[i] / (int64_t) bucket_counts[i];
+		size_t level = max > min ? (value - min) * 7 / (max - min) : 0;
+		memcpy(spark, blocks[level], 3);
+		spark += 3;
+	}
+	*spark = '\0';
+	return true;
+}
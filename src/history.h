@@ -0,0 +1,29 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// values kept for each run, new fields go at the end so older files can be told apart by their record size
+enum history_field { history_uptime,     // seconds
+	                 history_ram_used,   // bytes
+	                 history_ram_total,  // bytes
+	                 history_swap_used,  // bytes
+	                 history_swap_total, // bytes
+	                 history_field_count };
+
+#define HISTORY_SPARKLINE_WIDTH 16
+
+struct history_stats {
+	uint64_t min;
+	uint64_t max;
+	uint64_t avg;
+	char sparkline[HISTORY_SPARKLINE_WIDTH * 3 + 1]; // block characters are 3 bytes in UTF-8
+};
+
+// append the current values to the history file
+bool history_record(void);
+
+// map the history file so history_get_stats can be used
+bool history_load(void);
+bool history_get_stats(enum history_field field, struct history_stats *stats);
+#endif //HISTORY_H
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "logo.h"
+#include "modules.h"
+
+// columns between the logo and the module output
+#define LOGO_GAP 3
+
+const struct logo *find_logo(const char *id) {
+	if (!id) return NULL;
+	for (const struct logo *logo = logos; logo->id; ++logo)
+		if (strcmp(logo->id, id) == 0) return logo;
+	return NULL;
+}
+
+const struct logo *select_logo(void) {
+	// FO_LOGO can name a logo, or be set to a false value to hide it
+	char *name = getenv("FO_LOGO");
+	if (name) {
+		if (!getenv_bool("FO_LOGO")) return NULL;
+		const struct logo *logo = find_logo(name);
+		if (logo) return logo;
+	}
+
+	const struct logo *logo = NULL;
+
+	char *id = os_release_value("ID");
+	if (id) {
+		logo = find_logo(id);
+		free(id);
+	}
+
+	if (!logo) {
+		// fall back to the distros this one is based on
+		char *like = os_release_value("ID_LIKE");
+		if (like) {
+			char *saveptr;
+			for (char *tok = strtok_r(like, " ", &saveptr); tok && !logo; tok = strtok_r(NULL, " ", &saveptr))
+				logo = find_logo(tok);
+			free(like);
+		}
+	}
+
+	if (!logo) logo = find_logo("linux");
+	return logo;
+}
+
+void print_logo_line(const struct logo *logo, size_t row, bool allow_color, FILE *fp) {
+	if (!logo) return;
+
+	size_t width = 0;
+	if (row < logo->line_count) {
+		const struct logo_line *line = &logo->lines[row];
+		for (size_t i = 0; i < line->run_count; ++i) {
+			const struct logo_run *run = &line->runs[i];
+			if (allow_color && run->color != LOGO_DEFAULT_COLOR)
+				fprintf(fp, "\x1b[1m\x1b[38;5;%im", run->color);
+			fwrite(run->text, 1, run->length, fp);
+			if (allow_color && run->color != LOGO_DEFAULT_COLOR)
+				fputs("\x1b[0m", fp);
+		}
+		width = line->width;
+	}
+
+	// pad out to the widest line so the module output lines up
+	fprintf(fp, "%*s", (int) (logo->width - width + LOGO_GAP), "");
+}
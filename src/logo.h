@@ -0,0 +1,36 @@
+#ifndef LOGO_H
+#define LOGO_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// logos are generated at build time from the art in logo/ by tools/logogen.c,
+// so lines are already split and measured, and colors are already split into runs
+
+#define LOGO_DEFAULT_COLOR 0xffff
+
+struct logo_run {
+	const char *text;
+	uint16_t length;
+	uint16_t color; // 256 color index, or LOGO_DEFAULT_COLOR
+};
+
+struct logo_line {
+	const struct logo_run *runs;
+	uint16_t run_count;
+	uint16_t width; // display width of the whole line
+};
+
+struct logo {
+	const char *id; // matched against ID and ID_LIKE in os-release
+	const struct logo_line *lines;
+	uint16_t line_count;
+	uint16_t width; // display width of the widest line
+};
+
+extern const struct logo logos[]; // terminated by an entry with a NULL id
+
+const struct logo *find_logo(const char *id);
+const struct logo *select_logo(void);
+void print_logo_line(const struct logo *logo, size_t row, bool allow_color, FILE *fp);
+#endif //LOGO_H
@@ -3,8 +3,12 @@
 #include <stdbool.h>
 #include <string.h>
 #include <err.h>
+#include <getopt.h>
 
 #include "modules.h"
+#include "logo.h"
+#include "serve.h"
+#include "history.h"
 
 bool string_contains(char *list, char *substr, char *ifs) {
 	// checks if a substring is contained in list which is separated by ifs
@@ -45,7 +49,17 @@ bool string_contains(char *list, char *substr, char *ifs) {
 	return result;
 }
 
-void print_output(module_output output, bool allow_color, FILE *fp) {
+struct layout {
+	const struct logo *logo;
+	size_t row; // next logo line to print
+};
+
+void print_logo_column(struct layout *layout, bool allow_color, FILE *fp) {
+	if (!layout || !layout->logo) return;
+	print_logo_line(layout->logo, layout->row++, allow_color, fp);
+}
+
+void print_output(module_output output, bool allow_color, FILE *fp, struct layout *layout) {
 	if (!output) return;
 	if (!output[0].string) return;
 
@@ -53,6 +67,8 @@ void print_output(module_output output, bool allow_color, FILE *fp) {
 		fputc('\n', fp);
 	}
 
+	print_logo_column(layout, allow_color, fp);
+
 	for (size_t i = 0; output[i].string; ++i) {
 		struct colored_text text = output[i];
 		char *str = text.string;
@@ -81,6 +97,7 @@ void print_output(module_output output, bool allow_color, FILE *fp) {
 				fwrite(str, 1, len, fp);         // print the line
 				if (newline) {
 					print_newline();
+					print_logo_column(layout, allow_color, fp);
 					str = newline + 1;
 				} else
 					break;
@@ -95,13 +112,63 @@ void print_output(module_output output, bool allow_color, FILE *fp) {
 	print_newline();
 }
 
+static void usage(FILE *fp) {
+	fprintf(fp, "Usage: %s [OPTION]...\n", TARGET);
+	fprintf(fp, "  -h, --help           Shows help text\n");
+	fprintf(fp, "  -s, --serve ADDRESS  Serve metrics over HTTP on [HOST:]PORT or a unix socket path\n");
+	fprintf(fp, "  -r, --record         Append this run's values to the history file\n");
+	fprintf(fp, "  -H, --history        Show the recorded history next to the current values\n");
+}
+
 int main(int argc, char *argv[]) {
+	struct option options[] = {
+	        {"help", no_argument, NULL, 'h'},
+	        {"serve", required_argument, NULL, 's'},
+	        {"record", no_argument, NULL, 'r'},
+	        {"history", no_argument, NULL, 'H'},
+	        {0}
+	};
+
+	char *serve_address = NULL;
+	bool record = false, history = false;
+	int opt;
+	while ((opt = getopt_long(argc, argv, "hs:rH", options, NULL)) != -1) {
+		switch (opt) {
+			case 'h':
+				usage(stdout);
+				return 0;
+			case 's':
+				serve_address = optarg;
+				break;
+			case 'r':
+				record = true;
+				break;
+			case 'H':
+				history = true;
+				break;
+			default:
+				usage(stderr);
+				return 1;
+		}
+	}
+	if (optind < argc) {
+		usage(stderr);
+		return 1;
+	}
+
+	if (serve_address) return serve(serve_address);
+
+	if (history) history_load();
+
 	// allow user to change field separator
 	char *ifs = getenv("FO_IFS");
 	if (!ifs) ifs = " ";
 
 	char *modules_list = getenv("FO_MODULES");
 
+	// logo on the left, module output zipped alongside it
+	struct layout layout = {.logo = select_logo(), .row = 0};
+
 	// list modules
 	for (module *m = modules; m->name; ++m) {
 		if (modules_list) {
@@ -113,9 +180,20 @@ int main(int argc, char *argv[]) {
 		}
 		module_output output = m->func(m);
 		if (output) {
-			print_output(output, true, stdout);
+			print_output(output, true, stdout, &layout);
 			free(output);
 		}
 	}
+
+	// print the rest of the logo if it is taller than the output
+	if (layout.logo) {
+		while (layout.row < layout.logo->line_count) {
+			print_logo_column(&layout, true, stdout);
+			fputc('\n', stdout);
+		}
+	}
+
+	// record after the output, so --history only shows earlier runs, even once the ring has wrapped
+	if (record) history_record();
 	return 0;
 }
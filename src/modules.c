@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -11,6 +12,12 @@
 #include <proc/sysinfo.h>
 
 #include "modules.h"
+#include "width.h"
+#include "cgroup.h"
+#include "desktop.h"
+#include "history.h"
+#include "disk.h"
+#include "net.h"
 
 /*
 static void *pending_free[16];
@@ -45,20 +52,6 @@ static struct passwd *get_passwd() {
 	return passwd;
 }
 
-static struct sysinfo *get_sysinfo() {
-	static struct sysinfo *si = NULL;
-	static bool init = false;
-	if (!init) {
-		init = true;
-		static struct sysinfo si_;
-		if (sysinfo(&si_) < 0)
-			si = NULL;
-		else
-			si = &si_;
-	}
-	return si;
-}
-
 static char *get_basename(char *path) {
 	char *slash = strrchr(path, '/');
 	return slash ? slash + 1 : path;
@@ -68,6 +61,8 @@ enum format_bytes_mode { binary_i,
 	                     binary,
 	                     metric };
 
+const enum format_bytes_mode bytes_mode = binary_i;
+
 static char *format_bytes(size_t byte, enum format_bytes_mode mode) {
 	const int scale = 2;
 
@@ -216,6 +211,38 @@ snprintf_error:
 	return NULL;
 }
 
+static char *append_history(char *str, enum history_field field) {
+	// with --history, follow the current value with a sparkline and the range it has covered
+	struct history_stats stats;
+	if (!str || !history_get_stats(field, &stats)) return str;
+
+	char *min, *avg, *max;
+	if (field == history_uptime) {
+		min = format_time(stats.min);
+		avg = format_time(stats.avg);
+		max = format_time(stats.max);
+	} else {
+		min = format_bytes(stats.min, bytes_mode);
+		avg = format_bytes(stats.avg, bytes_mode);
+		max = format_bytes(stats.max, bytes_mode);
+	}
+
+	char *out = NULL;
+	if (min && avg && max) {
+		if (asprintf(&out, "%s  %s  min %s  avg %s  max %s", str, stats.sparkline, min, avg, max) < 0) {
+			warnx("asprintf");
+			out = NULL;
+		}
+	}
+	free(min);
+	free(avg);
+	free(max);
+
+	if (!out) return str;
+	free(str);
+	return out;
+}
+
 static char *get_hostname(void) {
 	struct utsname *un = get_utsname();
 	if (!un) return NULL;
@@ -302,7 +329,7 @@ char *parse_key_value_pair_list(char *key, char *data, size_t size) {
 
 		// found the matching line
 		char *value = equal + 1;
-		size_t value_len = eol - value;
+		size_t value_len = (eol ? eol : endptr) - value;
 
 		// trim surrounding quotes
 		if (
@@ -349,6 +376,7 @@ static module_output line(char *string, bool free_string, module *module) {
 	static bool init_nerd = false;
 	static bool use_nerd;
 	if (!init_nerd) {
+		init_nerd = true;
 		use_nerd = getenv_bool("FO_NERDFONTS");
 		char *term = getenv("TERM");
 		if (term && strcasecmp(term, "linux") == 0) use_nerd = false; // disable in tty
@@ -357,6 +385,9 @@ static module_output line(char *string, bool free_string, module *module) {
 	char *name = use_nerd ? module->symbol : module->name;
 	const size_t padded_len = use_nerd ? 4 : 9;
 
+	// the label only ever changes between runs, so measure it once per module
+	if (!module->label_width) module->label_width = display_width(name);
+
 	static int color = 0;
 	// rainbow gradient
 	int c = (int[]){1, 3, 2, 6, 4, 5}[color];
@@ -371,19 +402,11 @@ static module_output line(char *string, bool free_string, module *module) {
 	size_t index = 0;
 	out[index++] = (struct colored_text){.string = name, .free = false, .fg_color = c, .flags = FLAG_FG_COLOR | FLAG_BOLD};
 
-	size_t name_len = use_nerd ? 2 : strlen(module->name);
-	if (name_len < padded_len) {
-		// create spacing to pad module name to 9 chars
-		size_t spacing_size = padded_len - name_len;
-		char *spacing = malloc(spacing_size + 1);
-		if (!spacing) {
-			warn("malloc");
-			free(out);
-			return NULL;
-		}
-		memset(spacing, ' ', spacing_size);
-		spacing[spacing_size] = '\0';
-		out[index++] = (struct colored_text){.string = spacing, .free = true, .flags = 0};
+	if (module->label_width < padded_len) {
+		// pad module name to 9 columns, pointing into a shared run of spaces rather than allocating
+		static char spacing[] = "                ";
+		size_t spacing_size = padded_len - module->label_width;
+		out[index++] = (struct colored_text){.string = spacing + sizeof(spacing) - 1 - spacing_size, .free = false, .flags = 0};
 	}
 
 	out[index++] = (struct colored_text){.string = string, .free = free_string, .flags = 0};
@@ -423,11 +446,18 @@ module_output module_header(module *mod) {
 }
 
 module_output module_line(module *mod) {
-	size_t line_len = strlen(get_username()) + strlen(get_hostname()) + 1;
+	// the rule spans the columns taken up by user@host, not its bytes
+	size_t line_len = display_width(get_username()) + display_width(get_hostname()) + 1;
 
 	char *repeat_char = getenv("FO_LINETEXT");
 	if (!repeat_char) repeat_char = "─";
 	size_t repeat_char_len = strlen(repeat_char);
+	if (repeat_char_len == 0) return NULL;
+
+	// repeat wide text fewer times so the rule stays the same width
+	size_t repeat_char_width = display_width_n(repeat_char, repeat_char_len);
+	if (repeat_char_width > 1) line_len /= repeat_char_width;
+	if (line_len == 0) line_len = 1;
 
 	size_t str_len = repeat_char_len * line_len;
 	char *str = malloc(str_len + 1);
@@ -458,19 +488,32 @@ module_output module_line(module *mod) {
 	return out;
 }
 
-module_output module_os(module *mod) {
-	const char *os_release_file = "/etc/os-release";
+static bool get_os_release(void **data, size_t *size) {
+	static void *data_ = NULL;
+	static size_t size_ = 0;
+	static bool init = false;
+	if (!init) {
+		init = true;
+		if (!read_filename("/etc/os-release", &data_, &size_)) data_ = NULL;
+	}
+	if (!data_) return false;
+	*data = data_;
+	*size = size_;
+	return true;
+}
 
+char *os_release_value(char *key) {
 	void *data;
 	size_t size;
-	if (!read_filename(os_release_file, &data, &size)) return NULL;
+	if (!get_os_release(&data, &size)) return NULL;
+	return parse_key_value_pair_list(key, data, size);
+}
 
+module_output module_os(module *mod) {
 	char *name = NULL;
-	if (!name) name = parse_key_value_pair_list("PRETTY_NAME", data, size);
-	if (!name) name = parse_key_value_pair_list("NAME", data, size);
-	if (!name) name = parse_key_value_pair_list("ID", data, size);
-
-	free(data);
+	if (!name) name = os_release_value("PRETTY_NAME");
+	if (!name) name = os_release_value("NAME");
+	if (!name) name = os_release_value("ID");
 
 	return line(name, true, mod);
 }
@@ -496,11 +539,55 @@ module_output module_kernel(module *mod) {
 	return line(out, true, mod);
 }
 
+static bool get_pid1_start(unsigned long *start) {
+	// starttime is the 22nd field of /proc/1/stat, in clock ticks since boot
+	void *data;
+	size_t size;
+	if (!read_filename("/proc/1/stat", &data, &size)) return false;
+
+	// skip past the command name, which can contain spaces and parentheses
+	char *str = memrchr(data, ')', size);
+	bool found = false;
+	if (str) {
+		char *endptr = (char *) data + size;
+		int field = 2;
+		for (; str < endptr && field < 22; ++str)
+			if (*str == ' ') ++field;
+		if (field == 22 && str < endptr) {
+			long ticks = sysconf(_SC_CLK_TCK);
+			*start = strtoul(str, NULL, 10) / (ticks > 0 ? ticks : 100);
+			found = true;
+		}
+	}
+
+	free(data);
+	return found;
+}
+
+bool get_uptime(unsigned long *uptime) {
+	// not cached, so a long running process sees it change
+	struct sysinfo si;
+	if (sysinfo(&si) < 0) return false;
+	*uptime = si.uptime;
+
+	// sysinfo reports the host's uptime, in a container use the age of our pid 1 instead
+	static unsigned long pid1_start;
+	static bool have_pid1_start, init = false;
+	if (!init) {
+		init = true;
+		have_pid1_start = cgroup_limited() && get_pid1_start(&pid1_start);
+	}
+	if (have_pid1_start && pid1_start <= *uptime)
+		*uptime -= pid1_start;
+
+	return true;
+}
+
 module_output module_uptime(module *mod) {
-	struct sysinfo *si = get_sysinfo();
-	if (!si) return NULL;
+	unsigned long uptime;
+	if (!get_uptime(&uptime)) return NULL;
 
-	return line(format_time(si->uptime), true, mod);
+	return line(append_history(format_time(uptime), history_uptime), true, mod);
 }
 
 module_output module_shell(module *mod) {
@@ -510,11 +597,14 @@ module_output module_shell(module *mod) {
 	return line(get_basename(passwd->pw_shell), false, mod);
 }
 
-const enum format_bytes_mode bytes_mode = binary_i;
-
-module_output module_byte_display(size_t used, size_t total, module *mod) {
+static char *byte_display(size_t used, size_t total) {
 	char *used_str = format_bytes(used, bytes_mode);
 	char *total_str = format_bytes(total, bytes_mode);
+	if (!used_str || !total_str) {
+		free(used_str);
+		free(total_str);
+		return NULL;
+	}
 
 	size_t str_len = strlen(used_str) + strlen(total_str) + 4;
 	char *str = malloc(str_len);
@@ -535,76 +625,165 @@ module_output module_byte_display(size_t used, size_t total, module *mod) {
 	free(used_str);
 	free(total_str);
 
-	return line(str, true, mod);
+	return str;
 }
 
-module_output module_ram(module *mod) {
+module_output module_byte_display(size_t used, size_t total, module *mod) {
+	return line(byte_display(used, total), true, mod);
+}
+
+bool get_ram(size_t *used, size_t *total) {
 	meminfo(); // procps
-	return module_byte_display(kb_main_used * 1024, kb_main_total * 1024, mod);
+	*used = kb_main_used * 1024;
+	*total = kb_main_total * 1024;
+
+	// report the cgroup's usage and limit in place of the host's when it has one
+	uint64_t cg_used, cg_total;
+	if (cgroup_memory(&cg_used, &cg_total)) {
+		*used = cg_used;
+		if (cg_total < *total) *total = cg_total;
+	}
+	return true;
 }
 
-module_output module_swap(module *mod) {
+bool get_swap(size_t *used, size_t *total) {
 	meminfo(); // procps
-	return module_byte_display(kb_swap_used * 1024, kb_swap_total * 1024, mod);
+	*used = kb_swap_used * 1024;
+	*total = kb_swap_total * 1024;
+
+	uint64_t cg_used, cg_total;
+	if (cgroup_swap(&cg_used, &cg_total)) {
+		*used = cg_used;
+		if (cg_total < *total) *total = cg_total;
+	}
+	return true;
 }
 
-module_output module_de(module *mod) {
-	char *de = getenv("XDG_CURRENT_DESKTOP");
-	if (!de) return NULL;
-
-	char *result = NULL;
-
-	if (strcasestr(de, "kde") || strcasestr(de, "Plasma"))
-		result = "KDE Plasma";
-	else if (strcasestr(de, "cinnamon"))
-		result = "Cinnamon";
-	else if (strcasestr(de, "lxqt"))
-		result = "LXQt";
-	else if (strcasestr(de, "lxde"))
-		result = "LXDE";
-	else if (strcasestr(de, "deepin"))
-		result = "Deepin";
-	else if (strcasestr(de, "enlightenment"))
-		result = "Enlightenment";
-	else if (strcasestr(de, "budgie"))
-		result = "Budgie";
-	else if (strcasestr(de, "Pantheon"))
-		result = "Pantheon";
-	else if (getenv("TDE_FULL_SESSION"))
-		result = "Trinity";
-	else if (getenv("MATE_DESKTOP_SESSION_ID") || strcasestr(de, "mate"))
-		result = "MATE";
-	else if (strcasestr(de, "xfce"))
-		result = "Xfce";
-	else if (getenv("GNOME_DESKTOP_SESSION_ID") || strcasestr(de, "unity") || strcasestr(de, "gnome"))
-		result = "GNOME";
-	else if (strcasestr(de, "xfwm"))
-		result = "Xfwm";
-	else if (strcasestr(de, "openbox"))
-		result = "Openbox";
-	else if (strcasestr(de, "i3"))
-		result = "i3";
-	else if (strcasestr(de, "bspwm"))
-		result = "bspwm";
-	else if (strcasestr(de, "mutter"))
-		result = "Mutter";
-	else if (strcasestr(de, "sawfish"))
-		result = "Sawfish";
-	else if (strcasestr(de, "fluxbox"))
-		result = "Fluxbox";
-	else if (strcasestr(de, "icewm"))
-		result = "IceWM";
-	else if (strcasestr(de, "awesome"))
-		result = "awesome";
-	else if (strcasestr(de, "dwm"))
-		result = "dwm";
-	else if (de)
-		result = de;
-	else
-		result = getenv("DESKTOP_SESSION");
+module_output module_ram(module *mod) {
+	size_t used, total;
+	if (!get_ram(&used, &total)) return NULL;
+	return line(append_history(byte_display(used, total), history_ram_used), true, mod);
+}
+
+module_output module_swap(module *mod) {
+	size_t used, total;
+	if (!get_swap(&used, &total)) return NULL;
+	return line(append_history(byte_display(used, total), history_swap_used), true, mod);
+}
+
+static module_output join_lines(module_output *lines, size_t count) {
+	// join single line outputs into one, with a newline between each
+	// takes ownership of lines and everything in it, freeing it whether or not joining succeeds
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i)
+		for (size_t j = 0; lines[i] && lines[i][j].string; ++j) ++total;
+
+	module_output out = calloc(total + count + 1, sizeof(struct colored_text));
+	if (!out) warn("calloc");
+
+	size_t index = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (!lines[i]) continue;
+		if (out) {
+			if (index > 0) out[index++] = (struct colored_text){.string = "\n", .free = false, .flags = 0};
+			for (size_t j = 0; lines[i][j].string; ++j) out[index++] = lines[i][j];
+		} else {
+			for (size_t j = 0; lines[i][j].string; ++j)
+				if (lines[i][j].free) free(lines[i][j].string);
+		}
+		free(lines[i]);
+	}
+	free(lines);
+
+	if (out) out[index] = (struct colored_text){.string = NULL};
+	return out;
+}
+
+module_output module_disk(module *mod) {
+	struct disk_usage *disks;
+	size_t count = get_disk_usage(&disks);
+	if (count == 0) return NULL;
+
+	module_output *lines = calloc(count, sizeof(module_output));
+	if (!lines) {
+		warn("calloc");
+		free_disk_usage(disks, count);
+		return NULL;
+	}
+
+	// one line per mount
+	for (size_t i = 0; i < count; ++i) {
+		char *usage = disks[i].available ? byte_display(disks[i].used, disks[i].total) : strdup("unavailable");
+		char *str = NULL;
+		if (usage && asprintf(&str, "%s (%s)", usage, disks[i].mount_point) < 0) {
+			warnx("asprintf");
+			str = NULL;
+		}
+		free(usage);
+		lines[i] = line(str, true, mod);
+	}
+	free_disk_usage(disks, count);
+
+	return join_lines(lines, count);
+}
+
+module_output module_net(module *mod) {
+	struct net_interface *interfaces;
+	size_t count = get_net_interfaces(&interfaces);
+	if (count == 0) return NULL;
+
+	module_output *lines = calloc(count, sizeof(module_output));
+	if (!lines) {
+		warn("calloc");
+		free_net_interfaces(interfaces, count);
+		return NULL;
+	}
+
+	// one line per interface that has an address
+	size_t line_count = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (!interfaces[i].addresses) continue;
+		char *str;
+		if (asprintf(&str, "%s %s", interfaces[i].name, interfaces[i].addresses) < 0) {
+			warnx("asprintf");
+			continue;
+		}
+		lines[line_count++] = line(str, true, mod);
+	}
+	free_net_interfaces(interfaces, count);
+
+	return join_lines(lines, line_count);
+}
+
+module_output module_cpu(module *mod) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1) return NULL;
+
+	char *str;
+	uint64_t quota, period;
+	if (cgroup_cpu_quota(&quota, &period)) {
+		// cpu.max limits how much cpu time we get, not which cpus we run on
+		char limit[32];
+		snprintf(limit, sizeof(limit), "%.2f", (double) quota / period);
+		char *end = limit + strlen(limit);
+		while (end[-1] == '0') *--end = '\0'; // 1.50 -> 1.5, 2.00 -> 2.
+		if (end[-1] == '.') *--end = '\0';
+		if (asprintf(&str, "%ld (limited to %s)", cpus, limit) < 0) str = NULL;
+	} else {
+		if (asprintf(&str, "%ld", cpus) < 0) str = NULL;
+	}
+	if (!str) {
+		warnx("asprintf");
+		return NULL;
+	}
 
+	return line(str, true, mod);
+}
+
+module_output module_de(module *mod) {
+	const char *result = detect_desktop();
 	if (!result) return NULL;
-	return line(result, false, mod);
+	return line((char *) result, false, mod);
 }
 
 module_output module_editor(module *mod) {
@@ -665,6 +844,9 @@ module *modules = (module[]){
         {"shell", "", module_shell, true},
         {"ram", "󰍛", module_ram, true},
         {"swap", "󰓡", module_swap, true},
+        {"cpu", "󰻠", module_cpu, true},
+        {"disk", "󰋊", module_disk, true},
+        {"net", "󰈀", module_net, true},
         {"de", "", module_de, true},
         {"editor", "", module_editor, true},
         {"host", "󰍹", module_host, true},
@@ -26,7 +26,16 @@ typedef struct module {
 	char *symbol;
 	module_output (*func)(struct module *);
 	bool display_by_default;
+	size_t label_width; // cached display width of the label, 0 until first measured
 } module;
 
 extern module *modules;
+
+bool getenv_bool(const char *name);
+char *os_release_value(char *key);
+
+// raw values behind the uptime, ram and swap modules, in seconds and bytes
+bool get_uptime(unsigned long *uptime);
+bool get_ram(size_t *used, size_t *total);
+bool get_swap(size_t *used, size_t *total);
 #endif //MODULES_H
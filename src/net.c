@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <err.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "net.h"
+
+static char **split_patterns(char *patterns) {
+	// splits in place into a NULL terminated array, so matching a link allocates nothing
+	size_t count = 0;
+	for (const char *p = patterns + strspn(patterns, " "); *p; p += strspn(p, " ")) {
+		++count;
+		p += strcspn(p, " ");
+	}
+	char **tokens = malloc((count + 1) * sizeof(char *));
+	if (!tokens) {
+		warn("malloc");
+		return NULL;
+	}
+	size_t i = 0;
+	char *saveptr;
+	for (char *tok = strtok_r(patterns, " ", &saveptr); tok; tok = strtok_r(NULL, " ", &saveptr))
+		tokens[i++] = tok;
+	tokens[i] = NULL;
+	return tokens;
+}
+
+static bool interface_selected(char *const *patterns, const char *name, unsigned int flags) {
+	// without patterns everything but loopback is shown
+	if (!patterns) return !(flags & IFF_LOOPBACK);
+	for (; *patterns; ++patterns)
+		if (fnmatch(*patterns, name, 0) == 0) return true;
+	return false;
+}
+
+static bool interface_up(const struct ifinfomsg *ifi, int operstate) {
+	// virtual interfaces like tun often leave operstate unknown, so fall back to the flags
+	if (operstate == IF_OPER_UP) return true;
+	return operstate == IF_OPER_UNKNOWN && (ifi->ifi_flags & IFF_UP) && (ifi->ifi_flags & IFF_LOWER_UP);
+}
+
+struct net_list {
+	struct net_interface *interfaces;
+	size_t count;
+	size_t capacity;
+};
+
+static struct net_interface *find_interface(struct net_list *list, int index) {
+	for (size_t i = 0; i < list->count; ++i)
+		if (list->interfaces[i].index == index) return &list->interfaces[i];
+	return NULL;
+}
+
+static void parse_link(struct nlmsghdr *nlh, char *const *patterns, struct net_list *list) {
+	struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+	const char *name = NULL;
+	int operstate = IF_OPER_UNKNOWN;
+
+	int len = IFLA_PAYLOAD(nlh);
+	for (struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFLA_IFNAME)
+			name = RTA_DATA(rta);
+		else if (rta->rta_type == IFLA_OPERSTATE)
+			operstate = *(unsigned char *) RTA_DATA(rta);
+	}
+
+	// filter before allocating anything
+	if (!name || !interface_up(ifi, operstate) || !interface_selected(patterns, name, ifi->ifi_flags)) return;
+
+	if (list->count >= list->capacity) {
+		size_t capacity = list->capacity ? list->capacity * 2 : 8;
+		struct net_interface *interfaces = realloc(list->interfaces, capacity * sizeof(struct net_interface));
+		if (!interfaces) {
+			warn("realloc");
+			return;
+		}
+		list->interfaces = interfaces;
+		list->capacity = capacity;
+	}
+
+	struct net_interface *iface = &list->interfaces[list->count++];
+	*iface = (struct net_interface){.index = ifi->ifi_index, .addresses = NULL};
+	snprintf(iface->name, sizeof(iface->name), "%s", name);
+}
+
+static void parse_addr(struct nlmsghdr *nlh, struct net_list *list) {
+	struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+	if (ifa->ifa_scope == RT_SCOPE_LINK) return; // skip fe80::/10 and the like
+
+	struct net_interface *iface = find_interface(list, ifa->ifa_index);
+	if (!iface) return;
+
+	// IFA_LOCAL is our address on point to point links, where IFA_ADDRESS is the other end
+	void *address = NULL, *local = NULL;
+	int len = IFA_PAYLOAD(nlh);
+	for (struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFA_ADDRESS)
+			address = RTA_DATA(rta);
+		else if (rta->rta_type == IFA_LOCAL)
+			local = RTA_DATA(rta);
+	}
+	if (local) address = local;
+	if (!address) return;
+
+	char str[INET6_ADDRSTRLEN];
+	if (!inet_ntop(ifa->ifa_family, address, str, sizeof(str))) return;
+
+	char *addresses;
+	if (asprintf(&addresses, "%s%s%s/%u", iface->addresses ? iface->addresses : "", iface->addresses ? ", " : "", str, ifa->ifa_prefixlen) < 0) {
+		warnx("asprintf");
+		return;
+	}
+	free(iface->addresses);
+	iface->addresses = addresses;
+}
+
+static bool netlink_dump(int fd, uint16_t type, uint32_t seq, char *const *patterns, struct net_list *list) {
+	struct {
+		struct nlmsghdr nlh;
+		struct rtgenmsg gen;
+	} request = {
+	        .nlh = {.nlmsg_len = sizeof(request), .nlmsg_type = type, .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP, .nlmsg_seq = seq},
+	        .gen = {.rtgen_family = AF_UNSPEC},
+	};
+	struct sockaddr_nl kernel = {.nl_family = AF_NETLINK};
+	if (sendto(fd, &request, sizeof(request), 0, (struct sockaddr *) &kernel, sizeof(kernel)) < 0) {
+		warn("netlink");
+		return false;
+	}
+
+	// the dump arrives as a series of datagrams, each parsed as it comes in
+	static char buf[0x8000] __attribute__((aligned(NLMSG_ALIGNTO)));
+	for (;;) {
+		ssize_t len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			warn("netlink");
+			return false;
+		}
+
+		for (struct nlmsghdr *nlh = (struct nlmsghdr *) buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_seq != seq) continue;
+			if (nlh->nlmsg_type == NLMSG_DONE) return true;
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				warnx("netlink: dump failed");
+				return false;
+			}
+			if (nlh->nlmsg_type == RTM_NEWLINK)
+				parse_link(nlh, patterns, list);
+			else if (nlh->nlmsg_type == RTM_NEWADDR)
+				parse_addr(nlh, list);
+		}
+	}
+}
+
+size_t get_net_interfaces(struct net_interface **interfaces) {
+	*interfaces = NULL;
+
+	int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd < 0) {
+		warn("netlink");
+		return 0;
+	}
+
+	// links first to pick the interfaces, then addresses are only kept for those
+	struct net_list list = {0};
+	char *copy = NULL;
+	char **patterns = NULL;
+	const char *env = getenv("FO_NET_IFACES");
+	if (env) {
+		if (!(copy = strdup(env))) {
+			warn("strdup");
+			close(fd);
+			return 0;
+		}
+		if (!(patterns = split_patterns(copy))) {
+			free(copy);
+			close(fd);
+			return 0;
+		}
+	}
+	if (netlink_dump(fd, RTM_GETLINK, 1, patterns, &list) && list.count > 0)
+		netlink_dump(fd, RTM_GETADDR, 2, patterns, &list);
+	close(fd);
+	free(patterns);
+	free(copy);
+
+	*interfaces = list.interfaces;
+	return list.count;
+}
+
+void free_net_interfaces(struct net_interface *interfaces, size_t count) {
+	if (!interfaces) return;
+	for (size_t i = 0; i < count; ++i) free(interfaces[i].addresses);
+	free(interfaces);
+}
@@ -0,0 +1,16 @@
+#ifndef NET_H
+#define NET_H
+#include <stddef.h>
+#include <linux/if.h>
+
+struct net_interface {
+	int index;
+	char name[IFNAMSIZ];
+	char *addresses; // "addr/prefix, addr/prefix", or NULL if it has none
+};
+
+// interfaces that are up and match FO_NET_IFACES, a space separated list of patterns, or all but loopback by default
+// returns the number of entries in *interfaces, which the caller frees with free_net_interfaces
+size_t get_net_interfaces(struct net_interface **interfaces);
+void free_net_interfaces(struct net_interface *interfaces, size_t count);
+#endif //NET_H
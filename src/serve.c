@@ -0,0 +1,517 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <err.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/utsname.h>
+
+#include "serve.h"
+#include "modules.h"
+
+#define SERVE_MAX_CONNECTIONS 1024
+#define SERVE_RESERVED_FDS 32 // stdio, the listener, epoll, cached cgroup files and files read while refreshing
+#define SERVE_REQUEST_SIZE 2048
+#define SERVE_TIMEOUT 10           // seconds a client has to send its request and read the response
+#define SERVE_DEFAULT_INTERVAL 15 // seconds between refreshes of the volatile values
+
+// a complete HTTP response, shared between every connection sending it
+struct response {
+	size_t refs;
+	size_t len;
+	char data[];
+};
+
+struct connection {
+	int fd;
+	size_t slot;
+	time_t started;
+	size_t request_len;
+	char request[SERVE_REQUEST_SIZE];
+	struct response *response;
+	size_t sent;
+};
+
+struct buffer {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+static bool buffer_printf(struct buffer *buf, const char *format, ...) {
+	for (;;) {
+		va_list args;
+		va_start(args, format);
+		int len = vsnprintf(buf->data + buf->len, buf->size - buf->len, format, args);
+		va_end(args);
+		if (len < 0) {
+			warnx("vsnprintf");
+			return false;
+		}
+		if (buf->len + len < buf->size) {
+			buf->len += len;
+			return true;
+		}
+
+		size_t size = buf->size ? buf->size : 1024;
+		while (size <= buf->len + len) size *= 2;
+		char *data = realloc(buf->data, size);
+		if (!data) {
+			warn("realloc");
+			return false;
+		}
+		buf->data = data;
+		buf->size = size;
+	}
+}
+
+static bool buffer_escaped(struct buffer *buf, const char *str, bool json) {
+	// escapes for a prometheus label value or a json string, which only differ in control characters
+	if (!str) str = "";
+	for (; *str; ++str) {
+		unsigned char c = *str;
+		bool ok;
+		if (c == '\\' || c == '"')
+			ok = buffer_printf(buf, "\\%c", c);
+		else if (c == '\n')
+			ok = buffer_printf(buf, "\\n");
+		else if (c < 0x20 && json)
+			ok = buffer_printf(buf, "\\u%04x", c);
+		else
+			ok = buffer_printf(buf, "%c", c);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+static struct response *make_response(const char *status, const char *content_type, const char *body, size_t body_len) {
+	char header[256];
+	int header_len = snprintf(header, sizeof(header),
+	                          "HTTP/1.1 %s\r\n"
+	                          "Content-Type: %s\r\n"
+	                          "Content-Length: %zu\r\n"
+	                          "Connection: close\r\n"
+	                          "\r\n",
+	                          status, content_type, body_len);
+	if (header_len < 0 || header_len >= sizeof(header)) {
+		warnx("snprintf");
+		return NULL;
+	}
+
+	struct response *response = malloc(sizeof(struct response) + header_len + body_len);
+	if (!response) {
+		warn("malloc");
+		return NULL;
+	}
+	response->refs = 1;
+	response->len = header_len + body_len;
+	memcpy(response->data, header, header_len);
+	memcpy(response->data + header_len, body, body_len);
+	return response;
+}
+
+static void release_response(struct response *response) {
+	if (response && --response->refs == 0) free(response);
+}
+
+struct exporter {
+	// values that never change, serialized once at startup
+	struct buffer static_prom;
+	struct buffer static_json;
+
+	// full responses, rebuilt at most once per interval
+	struct response *prom;
+	struct response *json;
+	time_t refreshed;
+	time_t interval;
+
+	struct response *not_found;
+	struct response *bad_request;
+	struct response *unavailable;
+};
+
+static time_t monotonic_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static bool init_exporter(struct exporter *ex) {
+	*ex = (struct exporter){0};
+
+	ex->interval = SERVE_DEFAULT_INTERVAL;
+	char *interval = getenv("FO_SERVE_INTERVAL");
+	if (interval) {
+		char *end;
+		long value = strtol(interval, &end, 10);
+		if (end != interval && *end == '\0' && value >= 0) ex->interval = value;
+	}
+
+	struct utsname un;
+	if (uname(&un) < 0) memset(&un, 0, sizeof(un));
+
+	char *os = os_release_value("PRETTY_NAME");
+	if (!os) os = os_release_value("NAME");
+	if (!os) os = os_release_value("ID");
+
+	char kernel[sizeof(un.sysname) + sizeof(un.release) + 1];
+	snprintf(kernel, sizeof(kernel), "%s %s", un.sysname, un.release);
+
+	bool ok = buffer_printf(&ex->static_prom, "# HELP fetcho_info System information, the value is always 1.\n# TYPE fetcho_info gauge\nfetcho_info{hostname=\"") &&
+	          buffer_escaped(&ex->static_prom, un.nodename, false) &&
+	          buffer_printf(&ex->static_prom, "\",os=\"") &&
+	          buffer_escaped(&ex->static_prom, os, false) &&
+	          buffer_printf(&ex->static_prom, "\",kernel=\"") &&
+	          buffer_escaped(&ex->static_prom, kernel, false) &&
+	          buffer_printf(&ex->static_prom, "\",arch=\"") &&
+	          buffer_escaped(&ex->static_prom, un.machine, false) &&
+	          buffer_printf(&ex->static_prom, "\"} 1\n");
+
+	ok = ok &&
+	     buffer_printf(&ex->static_json, "\"hostname\":\"") &&
+	     buffer_escaped(&ex->static_json, un.nodename, true) &&
+	     buffer_printf(&ex->static_json, "\",\"os\":\"") &&
+	     buffer_escaped(&ex->static_json, os, true) &&
+	     buffer_printf(&ex->static_json, "\",\"kernel\":\"") &&
+	     buffer_escaped(&ex->static_json, kernel, true) &&
+	     buffer_printf(&ex->static_json, "\",\"arch\":\"") &&
+	     buffer_escaped(&ex->static_json, un.machine, true) &&
+	     buffer_printf(&ex->static_json, "\"");
+
+	free(os);
+	if (!ok) return false;
+
+	const char *not_found = "not found\n", *bad_request = "bad request\n", *unavailable = "could not read metrics\n";
+	ex->not_found = make_response("404 Not Found", "text/plain", not_found, strlen(not_found));
+	ex->bad_request = make_response("400 Bad Request", "text/plain", bad_request, strlen(bad_request));
+	ex->unavailable = make_response("503 Service Unavailable", "text/plain", unavailable, strlen(unavailable));
+	return ex->not_found && ex->bad_request && ex->unavailable;
+}
+
+static bool refresh_exporter(struct exporter *ex) {
+	time_t now = monotonic_seconds();
+	if (ex->prom && ex->json && now - ex->refreshed < ex->interval) return true;
+
+	unsigned long uptime = 0;
+	size_t ram_used = 0, ram_total = 0, swap_used = 0, swap_total = 0;
+	get_uptime(&uptime);
+	get_ram(&ram_used, &ram_total);
+	get_swap(&swap_used, &swap_total);
+
+	struct buffer prom = {0}, json = {0};
+	bool ok = buffer_printf(&prom, "%.*s", (int) ex->static_prom.len, ex->static_prom.data) &&
+	          buffer_printf(&prom,
+	                        "# HELP fetcho_uptime_seconds Time since boot, or since pid 1 started in a container.\n"
+	                        "# TYPE fetcho_uptime_seconds gauge\n"
+	                        "fetcho_uptime_seconds %lu\n"
+	                        "# HELP fetcho_memory_used_bytes Memory in use.\n"
+	                        "# TYPE fetcho_memory_used_bytes gauge\n"
+	                        "fetcho_memory_used_bytes %zu\n"
+	                        "# HELP fetcho_memory_total_bytes Total memory, or the cgroup limit.\n"
+	                        "# TYPE fetcho_memory_total_bytes gauge\n"
+	                        "fetcho_memory_total_bytes %zu\n"
+	                        "# HELP fetcho_swap_used_bytes Swap in use.\n"
+	                        "# TYPE fetcho_swap_used_bytes gauge\n"
+	                        "fetcho_swap_used_bytes %zu\n"
+	                        "# HELP fetcho_swap_total_bytes Total swap, or the cgroup limit.\n"
+	                        "# TYPE fetcho_swap_total_bytes gauge\n"
+	                        "fetcho_swap_total_bytes %zu\n",
+	                        uptime, ram_used, ram_total, swap_used, swap_total) &&
+	          buffer_printf(&json, "{%.*s,\"uptime\":%lu,\"ram\":{\"used\":%zu,\"total\":%zu},\"swap\":{\"used\":%zu,\"total\":%zu}}\n",
+	                        (int) ex->static_json.len, ex->static_json.data,
+	                        uptime, ram_used, ram_total, swap_used, swap_total);
+
+	struct response *new_prom = NULL, *new_json = NULL;
+	if (ok) {
+		new_prom = make_response("200 OK", "text/plain; version=0.0.4; charset=utf-8", prom.data, prom.len);
+		new_json = make_response("200 OK", "application/json", json.data, json.len);
+	}
+	free(prom.data);
+	free(json.data);
+	if (!new_prom || !new_json) {
+		release_response(new_prom);
+		release_response(new_json);
+		return false;
+	}
+
+	// connections still sending the old responses hold their own references
+	release_response(ex->prom);
+	release_response(ex->json);
+	ex->prom = new_prom;
+	ex->json = new_json;
+	ex->refreshed = now;
+	return true;
+}
+
+static struct response *route(struct exporter *ex, const char *request, size_t len) {
+	// only the request line matters: "GET /path HTTP/1.1"
+	if (len < 4 || memcmp(request, "GET ", 4) != 0) return ex->bad_request;
+	const char *path = request + 4;
+	size_t path_len = strcspn(path, " ?\r\n");
+
+	bool is_prom = (path_len == 8 && memcmp(path, "/metrics", 8) == 0) || (path_len == 1 && *path == '/');
+	bool is_json = path_len == 5 && memcmp(path, "/json", 5) == 0;
+	if (!is_prom && !is_json) return ex->not_found;
+
+	if (!refresh_exporter(ex)) {
+		// keep serving the last good values if there are any
+		if (!(is_prom ? ex->prom : ex->json)) return ex->unavailable; // our failure, not the client's
+	}
+	return is_prom ? ex->prom : ex->json;
+}
+
+static int open_listener(const char *address) {
+	if (strncmp(address, "unix:", 5) == 0 || strchr(address, '/')) {
+		const char *path = strncmp(address, "unix:", 5) == 0 ? address + 5 : address;
+		struct sockaddr_un sun = {.sun_family = AF_UNIX};
+		if (strlen(path) >= sizeof(sun.sun_path)) {
+			warnx("socket path too long: %s", path);
+			return -1;
+		}
+		strcpy(sun.sun_path, path);
+
+		// replace a socket left over from an earlier run, but nothing else
+		struct stat st;
+		if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0) {
+			warn("socket");
+			return -1;
+		}
+		if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0 || listen(fd, SOMAXCONN) < 0) {
+			warn("%s", path);
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	// [HOST:]PORT, where HOST can be in brackets for IPv6, and defaults to localhost
+	char *copy = strdup(address);
+	if (!copy) {
+		warn("strdup");
+		return -1;
+	}
+	char *host = "127.0.0.1", *port = copy;
+	char *colon = strrchr(copy, ':');
+	if (colon) {
+		*colon = '\0';
+		port = colon + 1;
+		host = copy;
+		if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+			host[strlen(host) - 1] = '\0';
+			++host;
+		}
+		if (!*host) host = NULL; // all interfaces
+	}
+
+	struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE};
+	struct addrinfo *result;
+	int gai = getaddrinfo(host, port, &hints, &result);
+	if (gai != 0) {
+		warnx("%s: %s", address, gai_strerror(gai));
+		free(copy);
+		return -1;
+	}
+
+	int fd = -1;
+	for (struct addrinfo *ai = result; ai && fd < 0; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0) continue;
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, SOMAXCONN) < 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	if (fd < 0) warn("%s", address);
+
+	freeaddrinfo(result);
+	free(copy);
+	return fd;
+}
+
+static struct connection *connections[SERVE_MAX_CONNECTIONS];
+static size_t connection_count = 0;
+static size_t max_connections = SERVE_MAX_CONNECTIONS;
+
+// the listener is taken out of epoll while no more connections can be accepted, otherwise it stays readable and the loop spins
+static int listen_fd = -1, epoll_fd = -1;
+static bool listening = true;
+
+static void set_listening(bool enable) {
+	if (listening == enable) return;
+	struct epoll_event ev = {.events = enable ? EPOLLIN : 0, .data.ptr = NULL};
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &ev) < 0) {
+		warn("epoll_ctl");
+		return;
+	}
+	listening = enable;
+}
+
+static void init_max_connections(void) {
+	// raise the soft fd limit as far as we could use it, and keep the cap within whatever we end up with
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return;
+	rlim_t wanted = SERVE_MAX_CONNECTIONS + SERVE_RESERVED_FDS;
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < wanted) {
+		rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || rl.rlim_max > wanted ? wanted : rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		getrlimit(RLIMIT_NOFILE, &rl);
+	}
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < wanted)
+		max_connections = rl.rlim_cur > SERVE_RESERVED_FDS ? rl.rlim_cur - SERVE_RESERVED_FDS : 1;
+}
+
+static void close_connection(struct connection *conn) {
+	connections[conn->slot] = NULL;
+	--connection_count;
+	close(conn->fd); // also removes it from epoll
+	release_response(conn->response);
+	free(conn);
+	set_listening(true); // there is room for another one now
+}
+
+static void accept_connections(void) {
+	while (connection_count < max_connections) {
+		int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+				set_listening(false); // out of descriptors, wait for a connection to close
+			return;
+		}
+
+		size_t slot;
+		for (slot = 0; slot < SERVE_MAX_CONNECTIONS && connections[slot]; ++slot);
+		struct connection *conn = slot < SERVE_MAX_CONNECTIONS ? malloc(sizeof(struct connection)) : NULL;
+		if (!conn) {
+			close(fd);
+			continue;
+		}
+		*conn = (struct connection){.fd = fd, .slot = slot, .started = monotonic_seconds()};
+
+		struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = conn};
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			close(fd);
+			free(conn);
+			continue;
+		}
+		connections[slot] = conn;
+		++connection_count;
+	}
+
+	// full, leave the rest in the backlog until a connection closes
+	set_listening(false);
+}
+
+static bool send_response(struct connection *conn) {
+	// returns false once the connection is finished with
+	while (conn->sent < conn->response->len) {
+		ssize_t len = send(conn->fd, conn->response->data + conn->sent, conn->response->len - conn->sent, MSG_NOSIGNAL);
+		if (len < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		conn->sent += len;
+	}
+	return false;
+}
+
+static bool handle_connection(struct connection *conn, struct exporter *ex, int epoll_fd, uint32_t events) {
+	// returns false once the connection is finished with
+	if (events & EPOLLERR) return false;
+	if (conn->response) return send_response(conn);
+
+	for (;;) {
+		size_t space = sizeof(conn->request) - conn->request_len - 1;
+		ssize_t len = recv(conn->fd, conn->request + conn->request_len, space, 0);
+		if (len == 0) return false;
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return true; // wait for more
+			return false;
+		}
+		conn->request_len += len;
+		conn->request[conn->request_len] = '\0';
+
+		// the request is complete at the end of the headers, anything too long to fit is rejected
+		bool complete = strstr(conn->request, "\r\n\r\n") || strstr(conn->request, "\n\n");
+		if (!complete && conn->request_len < sizeof(conn->request) - 1) continue;
+
+		conn->response = complete ? route(ex, conn->request, conn->request_len) : ex->bad_request;
+		++conn->response->refs;
+		shutdown(conn->fd, SHUT_RD);
+
+		struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = conn};
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) return false;
+		return send_response(conn);
+	}
+}
+
+int serve(const char *address) {
+	struct exporter ex;
+	if (!init_exporter(&ex)) return 1;
+
+	init_max_connections();
+
+	listen_fd = open_listener(address);
+	if (listen_fd < 0) return 1;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		warn("epoll_create1");
+		close(listen_fd);
+		return 1;
+	}
+	struct epoll_event listen_ev = {.events = EPOLLIN, .data.ptr = NULL};
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_ev) < 0) {
+		warn("epoll_ctl");
+		close(epoll_fd);
+		close(listen_fd);
+		return 1;
+	}
+
+	time_t last_sweep = monotonic_seconds();
+	struct epoll_event events[64];
+	for (;;) {
+		int count = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), 1000);
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			warn("epoll_wait");
+			break;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			struct connection *conn = events[i].data.ptr;
+			if (!conn)
+				accept_connections();
+			else if (!handle_connection(conn, &ex, epoll_fd, events[i].events))
+				close_connection(conn);
+		}
+
+		// drop clients that are too slow
+		time_t now = monotonic_seconds();
+		if (now != last_sweep) {
+			last_sweep = now;
+			// retry accepting at most once a second if descriptors ran out with nothing of ours to close
+			if (connection_count < max_connections) set_listening(true);
+			for (size_t i = 0; i < SERVE_MAX_CONNECTIONS; ++i)
+				if (connections[i] && now - connections[i]->started >= SERVE_TIMEOUT)
+					close_connection(connections[i]);
+		}
+	}
+
+	close(epoll_fd);
+	close(listen_fd);
+	return 1;
+}
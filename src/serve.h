@@ -0,0 +1,8 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+// serve metrics over HTTP on address until killed
+// address is "unix:PATH" or a path for a unix socket, or "[HOST:]PORT" for TCP
+// returns an exit code if the server could not be started
+int serve(const char *address);
+#endif //SERVE_H
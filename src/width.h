@@ -0,0 +1,12 @@
+#ifndef WIDTH_H
+#define WIDTH_H
+#include <stddef.h>
+#include <stdint.h>
+
+// number of terminal columns a code point takes up (0, 1 or 2)
+int codepoint_width(uint32_t cp);
+
+// number of terminal columns a UTF-8 string takes up
+size_t display_width(const char *str);
+size_t display_width_n(const char *str, size_t len);
+#endif //WIDTH_H
@@ -0,0 +1,183 @@
+// build time generator for the logos embedded in fetcho
+// usage: logogen FILE...
+// each file is named after an os-release ID and holds the art for that logo,
+// "${n}" switches to 256 color n, "${}" switches back to the default color and "$$" is a literal "$"
+// the output is C source defining the logos table from logo.h, with lines split, measured and colored ahead of time
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <err.h>
+
+#include "logo.h"
+#include "width.h"
+
+struct run {
+	char *text;
+	size_t length;
+	unsigned int color;
+};
+
+struct line {
+	size_t first_run;
+	size_t run_count;
+	size_t width;
+};
+
+static void *grow(void *ptr, size_t *capacity, size_t count, size_t size) {
+	if (count < *capacity) return ptr;
+	*capacity = *capacity ? *capacity * 2 : 16;
+	ptr = realloc(ptr, *capacity * size);
+	if (!ptr) err(1, "realloc");
+	return ptr;
+}
+
+static void print_string(const char *str, size_t len) {
+	// octal escapes keep any following digits from being read as part of the escape
+	putchar('"');
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			printf("\\%03o", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+static char *get_basename(char *path) {
+	char *slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+static void generate_logo(size_t index, char *filename, char **id, size_t *line_count_out, size_t *width_out) {
+	FILE *fp = fopen(filename, "r");
+	if (!fp) err(1, "%s", filename);
+
+	struct run *runs = NULL;
+	struct line *lines = NULL;
+	size_t run_count = 0, run_capacity = 0;
+	size_t line_count = 0, line_capacity = 0;
+	unsigned int color = LOGO_DEFAULT_COLOR;
+
+	char *buf = NULL;
+	size_t buf_size = 0;
+	ssize_t len;
+	while ((len = getline(&buf, &buf_size, fp)) >= 0) {
+		while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) buf[--len] = '\0';
+
+		lines = grow(lines, &line_capacity, line_count, sizeof(*lines));
+		struct line *line = &lines[line_count++];
+		*line = (struct line){.first_run = run_count};
+
+		char *text = malloc(len + 1);
+		if (!text) err(1, "malloc");
+		size_t text_len = 0;
+
+		// split the line into runs wherever the color changes
+		for (ssize_t i = 0; i <= len; ++i) {
+			unsigned int new_color = color;
+			size_t skip = 0;
+			if (i < len && buf[i] == '$') {
+				if (buf[i + 1] == '$') {
+					text[text_len++] = '$';
+					++i;
+					continue;
+				}
+				char *close;
+				if (buf[i + 1] != '{' || !(close = strchr(buf + i, '}')))
+					errx(1, "%s:%zu: expected ${n}, ${} or $$", filename, line_count);
+				if (close == buf + i + 2) {
+					new_color = LOGO_DEFAULT_COLOR;
+				} else {
+					char *end;
+					new_color = strtoul(buf + i + 2, &end, 10);
+					if (end != close || new_color > 255)
+						errx(1, "%s:%zu: invalid color", filename, line_count);
+				}
+				skip = close - (buf + i);
+			} else if (i < len) {
+				text[text_len++] = buf[i];
+				continue;
+			}
+
+			// end of a run, either a color change or the end of the line
+			if (text_len > 0) {
+				runs = grow(runs, &run_capacity, run_count, sizeof(*runs));
+				runs[run_count++] = (struct run){.text = text, .length = text_len, .color = color};
+				line->width += display_width_n(text, text_len);
+				++line->run_count;
+				if (!(text = malloc(len + 1))) err(1, "malloc");
+				text_len = 0;
+			}
+			color = new_color;
+			i += skip;
+		}
+		free(text);
+	}
+	if (ferror(fp)) err(1, "%s", filename);
+	free(buf);
+	fclose(fp);
+
+	// trailing blank lines would only push the module output down
+	while (line_count > 0 && lines[line_count - 1].run_count == 0) --line_count;
+	if (line_count == 0) errx(1, "%s: empty logo", filename);
+
+	size_t width = 0;
+	if (run_count > 0) {
+		printf("static const struct logo_run logo_%zu_runs[] = {\n", index);
+		for (size_t i = 0; i < run_count; ++i) {
+			printf("\t{.text = ");
+			print_string(runs[i].text, runs[i].length);
+			printf(", .length = %zu, .color = %u},\n", runs[i].length, runs[i].color);
+			free(runs[i].text);
+		}
+		printf("};\n");
+	}
+
+	printf("static const struct logo_line logo_%zu_lines[] = {\n", index);
+	for (size_t i = 0; i < line_count; ++i) {
+		if (lines[i].width > width) width = lines[i].width;
+		if (lines[i].run_count == 0)
+			printf("\t{.runs = NULL, .run_count = 0, .width = 0},\n");
+		else
+			printf("\t{.runs = logo_%zu_runs + %zu, .run_count = %zu, .width = %zu},\n", index, lines[i].first_run, lines[i].run_count, lines[i].width);
+	}
+	printf("};\n\n");
+
+	free(runs);
+	free(lines);
+
+	*id = get_basename(filename);
+	*line_count_out = line_count;
+	*width_out = width;
+}
+
+int main(int argc, char *argv[]) {
+	printf("// generated by logogen, do not edit\n");
+	printf("#include <stddef.h>\n#include \"logo.h\"\n\n");
+
+	char **ids = calloc(argc, sizeof(char *));
+	size_t *line_counts = calloc(argc, sizeof(size_t));
+	size_t *widths = calloc(argc, sizeof(size_t));
+	if (!ids || !line_counts || !widths) err(1, "calloc");
+
+	for (int i = 1; i < argc; ++i)
+		generate_logo(i, argv[i], &ids[i], &line_counts[i], &widths[i]);
+
+	printf("const struct logo logos[] = {\n");
+	for (int i = 1; i < argc; ++i) {
+		printf("\t{.id = ");
+		print_string(ids[i], strlen(ids[i]));
+		printf(", .lines = logo_%i_lines, .line_count = %zu, .width = %zu},\n", i, line_counts[i], widths[i]);
+	}
+	printf("\t{0}\n};\n");
+
+	free(ids);
+	free(line_counts);
+	free(widths);
+	return 0;
+}